@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "blockCache.h"
+#include "emSignal.h"
+#include "diagnostics.h"
+
+
+extern SigMem* sigMem;
+
+static bblock_t blockPool[BLOCK_POOL_SIZE];
+static bop_t opsPool[BLOCK_OPS_POOL_SIZE];
+static uint32_t blocksUsed;
+static uint32_t opsUsed;
+
+// Direct-mapped by address and privilege, a block pushed out is still reachable through chains
+static bblock_t* blockMap[BLOCK_MAP_SIZE];
+
+static uint32_t blockGen;
+// The text generation the blocks were built under
+static uint32_t blockTextGen;
+
+
+void flushBlocks() {
+	memset(blockMap, 0x0, sizeof(blockMap));
+	blocksUsed = 0;
+	opsUsed = 0;
+	blockGen++;
+	blockTextGen = sigMem->metadata.textGen;
+	dDebug(DB_DETAIL, "Flushed blocks (text generation %d)", blockTextGen);
+}
+
+bblock_t* lookupBlock(uint32_t addr, uint8_t priv) {
+	// Same as predecoded instructions, only the loader can make blocks stale
+	if (sigMem->metadata.textGen != blockTextGen) flushBlocks();
+
+	bblock_t* block = blockMap[BLOCK_MAP_IDX(addr, priv)];
+	if (block && block->addr == addr && block->priv == priv) return block;
+
+	return NULL;
+}
+
+bblock_t* startBlock(uint32_t addr, uint8_t priv) {
+	if (blocksUsed == BLOCK_POOL_SIZE || opsUsed + BLOCK_MAX_OPS > BLOCK_OPS_POOL_SIZE) {
+		dLog(D_NONE, DSEV_INFO, "Block pools full (%d blocks, %d ops), flushing", blocksUsed, opsUsed);
+		flushBlocks();
+	}
+
+	bblock_t* block = &blockPool[blocksUsed++];
+	block->addr = addr;
+	block->priv = priv;
+	block->length = 0;
+	block->ops = &opsPool[opsUsed];
+	block->next[BLOCK_EXIT_TAKEN] = NULL;
+	block->next[BLOCK_EXIT_FALL] = NULL;
+	block->hits = 0;
+	block->code = NULL;
+
+	opsUsed += BLOCK_MAX_OPS;
+
+	return block;
+}
+
+bblock_t* commitBlock(bblock_t* block, uint32_t length) {
+	// The block is always the last one started
+	opsUsed -= BLOCK_MAX_OPS - length;
+
+	if (length == 0) {
+		blocksUsed--;
+		return NULL;
+	}
+
+	block->length = length;
+	blockMap[BLOCK_MAP_IDX(block->addr, block->priv)] = block;
+	dDebug(DB_DETAIL, "Built block at 0x%x with %d ops", block->addr, length);
+
+	return block;
+}
+
+uint32_t blockGeneration() {
+	return blockGen;
+}
@@ -7,6 +7,9 @@
 #include "core.h"
 #include "mem.h"
 #include "hardware.h"
+#include "predecode.h"
+#include "fastCore.h"
+#include "blockCache.h"
 #include "emSignal.h"
 #include "diagnostics.h"
 
@@ -21,9 +24,12 @@ PS* userPS;
 extern pthread_mutex_t idleLock;
 extern pthread_cond_t idleCond;
 extern volatile bool IDLE;
+extern engine_t cpuEngine;
 
+#define CYCLE_LIMIT 500
 
-static void fault() {
+
+void fault() {
 	sigMem->metadata.signalType = UNIVERSAL_SIG;
 	int set = setFaultSignal(GET_SIGNAL(sigMem->signals, UNIVERSAL_SIG));
 	if (set != -1) {
@@ -35,7 +41,7 @@ static void fault() {
 	} else dLog(D_NONE, DSEV_WARN, "Was not able to set fault signal!");
 }
 
-static void exception(uint16_t excpNum) {
+void exception(uint16_t excpNum) {
 	dLog(D_NONE, DSEV_INFO, "Exception 0x%x!", excpNum);
 
 	uint32_t __psPtr = KERN_DATA + 0x4; // The virtual address where the pointer to PS is stored
@@ -62,6 +68,26 @@ static void exception(uint16_t excpNum) {
 	core.status = STAT_EXCP;
 }
 
+void handleFetchErr(memerr_t err) {
+	if (GET_PRIV(core.CSTR) != PRIVILEGE_KERNEL) {
+		// user code attempted to access elsewhere, run EVT
+		switch (err) {
+			case MEMERR_USER_SECT_READ:
+				dLog(D_NONE, DSEV_WARN, "User code attempted to access outside of its Process Address Space or System Libraries");
+				break;
+			case MEMERR_USER_OVERREAD:
+				dLog(D_NONE, DSEV_WARN, "User code attempted to overread from an allowed address");
+				break;
+			default:
+				break;
+		}
+		exception(EXCPN_ABORT_ACCESS);
+	} else {
+		dLog(D_NONE, DSEV_WARN, "Kernel code attempted to access outside of permissible range!");
+		fault();
+	}
+}
+
 static void fetch() {
 	// Reset state for new cycle if exception
 	if (core.status == STAT_EXCP) core.status = STAT_RUNNING;
@@ -76,25 +102,7 @@ static void fetch() {
 	core.IR += 4;
 	dDebug(DB_DETAIL, "Fetched from 0x%x, automatically increment to 0x%x", core.IR-4, core.IR);
 
-	if (err != MEMERR_NONE) {
-		if (GET_PRIV(core.CSTR) != PRIVILEGE_KERNEL) {
-			// user code attempted to access elsewhere, run EVT
-			switch (err) {
-				case MEMERR_USER_SECT_READ:
-					dLog(D_NONE, DSEV_WARN, "User code attempted to access outside of its Process Address Space or System Libraries");
-					break;
-				case MEMERR_USER_OVERREAD:
-					dLog(D_NONE, DSEV_WARN, "User code attempted to overread from an allowed address");
-					break;
-				default:
-					break;
-			}
-			exception(EXCPN_ABORT_ACCESS);
-		} else {
-			dLog(D_NONE, DSEV_WARN, "Kernel code attempted to access outside of permissible range!");
-			fault();
-		}
-	}
+	if (err != MEMERR_NONE) handleFetchErr(err);
 
 	dLog(D_NONE, DSEV_INFO, "fetch::Got 0x%x", FetchCtx.instrbits);
 }
@@ -141,7 +149,8 @@ void extractRegs() {
 	uint8_t _rsR = u32bitextract(FetchCtx.instrbits, 10, 5);
 	uint8_t _rr = u32bitextract(FetchCtx.instrbits, 5, 5);
 
-	uint8_t rd, rs, rr;
+	// Registers not used by the instruction type are left as X0
+	uint8_t rd = 0, rs = 0, rr = 0;
 
 	itype_t type = DecodeCtx.iType;
 	opcode_t opcode = FetchCtx.opcode;
@@ -229,22 +238,7 @@ static bool checkCondition() {
 	dLog(D_NONE, DSEV_INFO, "Checking condition 0x%x", cond);
 	dLog(D_NONE, DSEV_INFO, "Status 0x%x", core.CSTR);
 
-	switch (cond)	{
-		case COND_EQ: return GET_Z(core.CSTR) == 1;
-		case COND_NE: return GET_Z(core.CSTR) == 0;
-		case COND_OV: return GET_O(core.CSTR) == 1;
-		case COND_NV: return GET_O(core.CSTR) == 0;
-		case COND_MI: return GET_N(core.CSTR) == 1;
-		case COND_PZ: return GET_N(core.CSTR) == 0;
-		case COND_CC: return GET_C(core.CSTR) == 0;
-		case COND_CS: return GET_C(core.CSTR) == 1;
-		case COND_GT: return GET_N(core.CSTR) == GET_O(core.CSTR) && GET_Z(core.CSTR) == 0;
-		case COND_GE: return GET_N(core.CSTR) == GET_O(core.CSTR);
-		case COND_LT: return GET_N(core.CSTR) != GET_O(core.CSTR);
-		case COND_LE: return GET_N(core.CSTR) != GET_O(core.CSTR) || GET_Z(core.CSTR) != 0;
-	}
-
-	return false;
+	return checkCondFlags(cond, core.CSTR);
 }
 
 static void nextIR() {
@@ -288,25 +282,17 @@ static void nextIR() {
 	}
 }
 
-static void decode() {
-	if (core.status == STAT_EXCP) return;
-
+/**
+ * Decodes the fetched instruction bits into the decode context.
+ * This only does what depends on the instruction bits, so the result can be predecoded.
+ */
+static void decodeInstr() {
 	uint8_t opcode = (FetchCtx.instrbits >> 24) & 0xff;
 	opcode_t code = imap[opcode];
 	FetchCtx.opcode = code;
 
 	dLog(D_NONE, DSEV_INFO, "decode::Opcode: 0x%x; code %d -> %s", opcode, code, (code != OP_ERROR) ? istrmap[code] : "OP_ERROR");
 
-	// Invalid instruction
-	if (code == OP_ERROR) {
-		dLog(D_NONE, DSEV_WARN, "Invalid instruction: 0x%x!", opcode);
-		if (GET_PRIV(core.CSTR) == PRIVILEGE_KERNEL) { // Kill for kernel code
-			fault();
-		} else { // EVT for user code
-			exception(EXCPN_ABORT_INSTR);
-		}
-	}
-
 	if (code == OP_ADDS || code == OP_SUBS || code == OP_CMP) DecodeCtx.setCC = true;
 	else DecodeCtx.setCC = false;
 
@@ -349,23 +335,6 @@ static void decode() {
 
 		dLog(D_NONE, DSEV_INFO, "OP_SYS -> %s (opcode %d)", (subcode != OP_ERROR) ? istrmap[subcode] : "OP_ERROR", subcode);
 
-		if (subcode == OP_ERROR) {
-			dLog(D_NONE, DSEV_WARN, "Invalid instruction: 0x%x!", subcode);
-			if (GET_PRIV(core.CSTR) == PRIVILEGE_KERNEL) { // Kill for kernel code
-				fault();
-			} else { // EVT for user code
-				exception(EXCPN_ABORT_INSTR);
-			}
-		}
-
-		if (subcode != OP_SYSCALL) {
-			// Syscall is the only S-type that is unprivileged (for now??), the rest are privileged
-			if (GET_PRIV(core.CSTR) != PRIVILEGE_KERNEL) {
-				dLog(D_NONE, DSEV_WARN, "Used privileged instruction 0x%x!", subcode);
-				exception(EXCPN_ABORT_PRIV);
-			}
-		}
-
 		FetchCtx.opcode = subcode;
 	}
 
@@ -374,7 +343,6 @@ static void decode() {
 
 	DecodeCtx.regwrite = false;
 	DecodeCtx.memwrite = false;
-	ExecuteCtx.cond = false;
 
 	if (DecodeCtx.iType == I_TYPE || DecodeCtx.iType == R_TYPE || (FetchCtx.opcode >= OP_LD && FetchCtx.opcode <= OP_LDHZ) || 
 		FetchCtx.opcode == OP_CALL || (FetchCtx.opcode >= OP_LDIR && FetchCtx.opcode <= OP_RESR)) DecodeCtx.regwrite = true;
@@ -385,14 +353,100 @@ static void decode() {
 
 	if (FetchCtx.opcode == OP_ADDS || FetchCtx.opcode == OP_SUBS || FetchCtx.opcode == OP_CMP) DecodeCtx.setCC = true;
 
+	decideALUOp();
+	dLog(D_NONE, DSEV_INFO, "decode::ALU OP: %s", ALUOP_STR[DecodeCtx.aluop]);
+}
+
+static void savePredecoded(pdinstr_t* entry) {
+	entry->instrbits = FetchCtx.instrbits;
+	entry->opcode = FetchCtx.opcode;
+	entry->iType = DecodeCtx.iType;
+	entry->imm = DecodeCtx.imm;
+	entry->rd = DecodeCtx.rd;
+	entry->rs = DecodeCtx.rs;
+	entry->rr = DecodeCtx.rr;
+	entry->aluop = DecodeCtx.aluop;
+	entry->memSize = DecodeCtx.memSize;
+	entry->setCC = DecodeCtx.setCC;
+	entry->regwrite = DecodeCtx.regwrite;
+	entry->memwrite = DecodeCtx.memwrite;
+	entry->write = MemoryCtx.write;
+	entry->valid = true;
+}
+
+static void loadPredecoded(pdinstr_t* entry) {
+	FetchCtx.opcode = entry->opcode;
+	DecodeCtx.iType = entry->iType;
+	DecodeCtx.imm = entry->imm;
+	DecodeCtx.rd = entry->rd;
+	DecodeCtx.rs = entry->rs;
+	DecodeCtx.rr = entry->rr;
+	DecodeCtx.aluop = entry->aluop;
+	DecodeCtx.memSize = entry->memSize;
+	DecodeCtx.setCC = entry->setCC;
+	DecodeCtx.regwrite = entry->regwrite;
+	DecodeCtx.memwrite = entry->memwrite;
+	MemoryCtx.write = entry->write;
+}
+
+pdinstr_t* predecode(uint32_t addr, uint32_t instrbits) {
+	pdinstr_t* pd = lookupPredecoded(addr);
+	if (pd) return pd;
+
+	// Decoding goes through the pipeline contexts, which still belong to the last instruction
+	InstrCtx saved = core.uarch;
+
+	FetchCtx.instrbits = instrbits;
+	decodeInstr();
+	if (FetchCtx.opcode != OP_ERROR) {
+		pd = claimPredecoded(addr);
+		savePredecoded(pd);
+	}
+
+	core.uarch = saved;
+	return pd;
+}
+
+static void decode() {
+	if (core.status == STAT_EXCP) return;
+
+	// IR was already incremented on fetch
+	uint32_t addr = core.IR - 4;
+
+	pdinstr_t* pd = lookupPredecoded(addr);
+	if (pd) {
+		loadPredecoded(pd);
+		dLog(D_NONE, DSEV_INFO, "decode::Predecoded 0x%x -> %s", addr, (FetchCtx.opcode != OP_ERROR) ? istrmap[FetchCtx.opcode] : "OP_ERROR");
+	} else {
+		decodeInstr();
+		// Invalid instructions always take the slow path
+		if (FetchCtx.opcode != OP_ERROR) savePredecoded(claimPredecoded(addr));
+	}
+
+	// Invalid instruction
+	if (FetchCtx.opcode == OP_ERROR) {
+		dLog(D_NONE, DSEV_WARN, "Invalid instruction: 0x%x!", FetchCtx.instrbits);
+		if (GET_PRIV(core.CSTR) == PRIVILEGE_KERNEL) { // Kill for kernel code
+			fault();
+		} else { // EVT for user code
+			exception(EXCPN_ABORT_INSTR);
+		}
+	}
+
+	if (DecodeCtx.iType == S_TYPE && FetchCtx.opcode != OP_SYSCALL) {
+		// Syscall is the only S-type that is unprivileged (for now??), the rest are privileged
+		if (GET_PRIV(core.CSTR) != PRIVILEGE_KERNEL) {
+			dLog(D_NONE, DSEV_WARN, "Used privileged instruction 0x%x!", FetchCtx.opcode);
+			exception(EXCPN_ABORT_PRIV);
+		}
+	}
+
+	ExecuteCtx.cond = false;
 	if (FetchCtx.opcode == OP_B) {
 		ExecuteCtx.cond = checkCondition();
 		dLog(D_NONE, DSEV_INFO, "Condition marked as %d", ExecuteCtx.cond);
 	}
 
-	decideALUOp();
-	dLog(D_NONE, DSEV_INFO, "decode::ALU OP: %s", ALUOP_STR[DecodeCtx.aluop]);
-
 	regfile(false);
 	dLog(D_NONE, DSEV_INFO, "decode::Reg A val: 0x%x; Reg B val: 0x%x", DecodeCtx.vala, DecodeCtx.valb);
 
@@ -448,6 +502,67 @@ static void execute() {
 	// vcu();
 }
 
+void handleMemErr(memerr_t err) {
+	if (GET_PRIV(core.CSTR) == PRIVILEGE_KERNEL) {
+		switch (err) {
+			case MEMERR_KERN_OVERFLOW:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel overflow!");
+				break;
+			case MEMERR_KERN_OVERREAD:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel overread!");
+				break;
+			case MEMERR_KERN_STACK_OVERFLOW:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel stack overflow!");
+				break;
+			case MEMERR_KERN_HEAP_OVERFLOW:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel heap overflow!");
+				break;
+			case MEMERR_KERN_TEXT_WRITE:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel writing to text!");
+				break;
+			case MEMERR_KERN_SECT_WRITE:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel writing to invalid memory!");
+				break;
+			case MEMERR_KERN_SECT_READ:
+				dLog(D_NONE, DSEV_WARN, "Detected kernel reading from invalid memory!");
+				break;
+			default:
+				break;
+		}
+		fault();
+	} else {
+		switch (err) {
+			case MEMERR_USER_OVERFLOW:
+				dLog(D_NONE, DSEV_WARN, "Detected user overflow!");
+				break;
+			case MEMERR_USER_OVERREAD:
+				dLog(D_NONE, DSEV_WARN, "Detected user overread!");
+				break;
+			case MEMERR_USER_STACK_OVERFLOW:
+				dLog(D_NONE, DSEV_WARN, "Detected user stack overflow!");
+				break;
+			case MEMERR_USER_HEAP_OVERFLOW:
+				dLog(D_NONE, DSEV_WARN, "Detected user heap overflow!");
+				break;
+			case MEMERR_USER_TEXT_WRITE:
+				dLog(D_NONE, DSEV_WARN, "Detected user writing to text!");
+				break;
+			case MEMERR_USER_CONST_WRITE:
+				dLog(D_NONE, DSEV_WARN, "Detected user writing to const!");
+				break;
+			case MEMERR_USER_SECT_WRITE:
+				dLog(D_NONE, DSEV_WARN, "Detected user writing to invalid memory!");
+				break;
+			case MEMERR_USER_SECT_READ:
+				dLog(D_NONE, DSEV_WARN, "Detected user reading from invalid memory!");
+				break;
+			default:
+				break;
+		}
+		exception(EXCPN_ABORT_ACCESS);
+	}
+}
+
 static void memory() {
 	if (core.status == STAT_EXCP) return;
 
@@ -470,67 +585,7 @@ static void memory() {
 		fault();
 	}
 
-	if (err != MEMERR_NONE) {
-		if (GET_PRIV(core.CSTR) == PRIVILEGE_KERNEL) {
-			switch (err) {
-				case MEMERR_KERN_OVERFLOW:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel overflow!");
-					break;
-				case MEMERR_KERN_OVERREAD:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel overread!");
-					break;
-				case MEMERR_KERN_STACK_OVERFLOW:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel stack overflow!");
-					break;
-				case MEMERR_KERN_HEAP_OVERFLOW:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel heap overflow!");
-					break;
-				case MEMERR_KERN_TEXT_WRITE:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel writing to text!");
-					break;
-				case MEMERR_KERN_SECT_WRITE:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel writing to invalid memory!");
-					break;
-				case MEMERR_KERN_SECT_READ:
-					dLog(D_NONE, DSEV_WARN, "Detected kernel reading from invalid memory!");
-					break;
-				default:
-					break;
-			}
-			fault();
-		} else {
-			switch (err) {
-				case MEMERR_USER_OVERFLOW:
-					dLog(D_NONE, DSEV_WARN, "Detected user overflow!");
-					break;
-				case MEMERR_USER_OVERREAD:
-					dLog(D_NONE, DSEV_WARN, "Detected user overread!");
-					break;
-				case MEMERR_USER_STACK_OVERFLOW:
-					dLog(D_NONE, DSEV_WARN, "Detected user stack overflow!");
-					break;
-				case MEMERR_USER_HEAP_OVERFLOW:
-					dLog(D_NONE, DSEV_WARN, "Detected user heap overflow!");
-					break;
-				case MEMERR_USER_TEXT_WRITE:
-					dLog(D_NONE, DSEV_WARN, "Detected user writing to text!");
-					break;
-				case MEMERR_USER_CONST_WRITE:
-					dLog(D_NONE, DSEV_WARN, "Detected user writing to const!");
-					break;
-				case MEMERR_USER_SECT_WRITE:
-					dLog(D_NONE, DSEV_WARN, "Detected user writing to invalid memory!");
-					break;
-				case MEMERR_USER_SECT_READ:
-					dLog(D_NONE, DSEV_WARN, "Detected user reading from invalid memory!");
-					break;
-				default:
-					break;
-			}
-			exception(EXCPN_ABORT_ACCESS);
-		}
-	}
-
+	if (err != MEMERR_NONE) handleMemErr(err);
 
 	if (DecodeCtx.memwrite) MemoryCtx.valout = ExecuteCtx.aluValb;
 	else MemoryCtx.valout = ExecuteCtx.alures;
@@ -560,7 +615,12 @@ void initCore() {
 	core.CSTR = 0x0000;
 	core.ESR = 0x0000;
 
+	core.setCSTR = 0x00000000;
+
 	memset(&core.uarch, 0x0, sizeof(InstrCtx));
+
+	flushPredecode();
+	flushBlocks();
 }
 
 void viewCoreState() {
@@ -580,6 +640,19 @@ void viewCoreState() {
 	// fflush(stdout);
 }
 
+void stepCore() {
+	fetch();
+	decode();
+	execute();
+	memory();
+
+	if (FetchCtx.opcode == OP_ERET) {
+		core.CSTR = userPS->cstr;
+		// Saved CSTR contains the mode bit to kernel mode, reset it
+		core.CSTR = CLR_PRIV(core.CSTR);
+	}
+}
+
 void* runCore(void* _) {
 	dLog(D_NONE, DSEV_INFO, "Executing core thread...");
 	core.status = STAT_RUNNING;
@@ -589,24 +662,16 @@ void* runCore(void* _) {
 	while (true) {
 		pthread_mutex_lock(&idleLock);
 		if (!IDLE) {
-			dLog(D_NONE, DSEV_INFO, "\nCycle %d", runningCycles);
-			fetch();
-			decode();
-			execute();
-			memory();
-
-			if (FetchCtx.opcode == OP_ERET) {
-				core.CSTR = userPS->cstr;
-				// Saved CSTR contains the mode bit to kernel mode, reset it
-				core.CSTR = CLR_PRIV(core.CSTR);
-			}
-
-			runningCycles++;
+			if (cpuEngine == ENGINE_REFERENCE) {
+				dLog(D_NONE, DSEV_INFO, "\nCycle %d", runningCycles);
+				stepCore();
+				runningCycles++;
+			} else runningCycles += runFast(CYCLE_LIMIT+1 - runningCycles);
 
 			// viewCoreState();
 
 			// In case of an infinite loop or something, limit how much it can cycle for
-			if (runningCycles > 500) core.status = STAT_HLT;
+			if (runningCycles > CYCLE_LIMIT) core.status = STAT_HLT;
 			dDebug(DB_BASIC, "Heap pointer (VA) 0x%x", *((uint32_t*)(emMem + KERN_DATA)));
 			if (core.status == STAT_HLT) {
 				dLog(D_NONE, DSEV_INFO, "Going idle");
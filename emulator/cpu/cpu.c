@@ -20,6 +20,7 @@
 #include "core.h"
 #include "mem.h"
 #include "sigHeap.h"
+#include "jit.h"
 
 core_t core;
 uint8_t* emMem;
@@ -29,6 +30,7 @@ opcode_t imap[1<<8];
 pthread_mutex_t idleLock = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t idleCond = PTHREAD_COND_INITIALIZER;
 volatile bool IDLE = false;
+engine_t cpuEngine = ENGINE_FAST;
 
 
 char* istrmap[] = {
@@ -237,8 +239,35 @@ void initIMap() {
 }
 
 
+static void parseArgs(int argc, char* const argv[]) {
+	static struct option options[] = {
+		{"reference", no_argument, NULL, 'r'},
+		{"jit", no_argument, NULL, 'j'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "rj", options, NULL)) != -1) {
+		switch (opt) {
+			case 'r':
+				cpuEngine = ENGINE_REFERENCE;
+				break;
+			case 'j':
+				cpuEngine = ENGINE_JIT;
+				break;
+			default:
+				dLog(D_NONE, DSEV_WARN, "Unknown CPU option, ignoring");
+				break;
+		}
+	}
+}
+
+
 int main(int argc, char const* argv[]) {
 	initDiagnostics(stdout, "cpu.debug");
+	parseArgs(argc, (char* const*) argv);
+	if (cpuEngine == ENGINE_JIT && !initJIT()) cpuEngine = ENGINE_FAST;
+	dLog(D_NONE, DSEV_INFO, "Using the %s engine", (cpuEngine == ENGINE_REFERENCE) ? "reference" : (cpuEngine == ENGINE_JIT) ? "JIT" : "fast");
 
 	dLog(D_NONE, DSEV_INFO, "Setting up...");
 
@@ -0,0 +1,275 @@
+#include "fastCore.h"
+#include "core.h"
+#include "hardware.h"
+#include "predecode.h"
+#include "blockCache.h"
+#include "jit.h"
+#include "diagnostics.h"
+
+
+extern core_t core;
+extern engine_t cpuEngine;
+
+// Index 31 is SP, writes to X30 are dropped, the same as regfile()
+#define REG(r) (((r) == 31) ? core.SP : core.GPR[(r)])
+#define SETREG(r, val) do { \
+		uint32_t _val = (val); \
+		if ((r) == 31) core.SP = _val; \
+		else if ((r) != 30) core.GPR[(r)] = _val; \
+	} while (0)
+
+// Moves on to the next op of the block
+// IR is incremented before the handler runs, as on fetch
+#define NEXT() do { \
+		if (op+1 == end) goto blockEnd; \
+		op++; \
+		core.IR += 4; \
+		retired++; \
+		goto *op->handler; \
+	} while (0)
+
+// Leaves the block through one of its successor slots, core.IR holding the next address
+#define EXIT(slot) do { \
+		exitSlot = (slot); \
+		goto chain; \
+	} while (0)
+
+#define ALU_I(label, expr) label: { \
+		uint32_t a = REG(op->rs); \
+		uint32_t b = (uint32_t) op->imm; \
+		SETREG(op->rd, (expr)); \
+	} NEXT();
+
+#define ALU_R(label, expr) label: { \
+		uint32_t a = REG(op->rs); \
+		uint32_t b = REG(op->rr); \
+		SETREG(op->rd, (expr)); \
+	} NEXT();
+
+#define ALU_CC(label, valb, aluop, expr) label: { \
+		uint32_t a = REG(op->rs); \
+		uint32_t b = (valb); \
+		uint32_t res = (expr); \
+		setCondFlags(aluop, a, b, res); \
+		SETREG(op->rd, res); \
+	} NEXT();
+
+// M-types use the index register when there is no offset
+#define MEM_ADDR() (REG(op->rs) + ((op->imm == 0) ? REG(op->rr) : (uint32_t) op->imm))
+
+
+uint32_t runFast(uint32_t budget) {
+	static const void* iHandlers[OP_CMP+1] = {
+		[OP_ADD] = &&I_ADD, [OP_ADDS] = &&I_ADDS, [OP_SUB] = &&I_SUB, [OP_SUBS] = &&I_SUBS,
+		[OP_OR] = &&I_OR, [OP_AND] = &&I_AND, [OP_XOR] = &&I_XOR, [OP_NOT] = &&NOT,
+		[OP_LSL] = &&I_LSL, [OP_LSR] = &&I_LSR, [OP_ASR] = &&I_ASR
+	};
+	static const void* rHandlers[OP_CMP+1] = {
+		[OP_ADD] = &&R_ADD, [OP_ADDS] = &&R_ADDS, [OP_SUB] = &&R_SUB, [OP_SUBS] = &&R_SUBS,
+		[OP_OR] = &&R_OR, [OP_AND] = &&R_AND, [OP_XOR] = &&R_XOR, [OP_NOT] = &&NOT,
+		[OP_LSL] = &&R_LSL, [OP_LSR] = &&R_LSR, [OP_ASR] = &&R_ASR,
+		[OP_MUL] = &&R_MUL, [OP_SMUL] = &&R_MUL, [OP_DIV] = &&R_DIV, [OP_SDIV] = &&R_DIV
+	};
+
+	bblock_t* blk = NULL;
+	bblock_t* linkFrom = NULL;
+	int exitSlot = BLOCK_EXIT_FALL;
+	bop_t* op = NULL;
+	bop_t* end = NULL;
+	uint32_t retired = 0;
+	// The reference pipeline looks at the opcode of the last instruction (ERET, SYSCALL) even when the fetch fails
+	opcode_t lastOpcode = FetchCtx.opcode;
+
+	goto lookup;
+
+	ALU_I(I_ADD, a + b)
+	ALU_CC(I_ADDS, (uint32_t) op->imm, ALU_PLUS, a + b)
+	ALU_I(I_SUB, a - b)
+	ALU_CC(I_SUBS, (uint32_t) op->imm, ALU_MINUS, a - b)
+	ALU_I(I_OR, a | b)
+	ALU_I(I_AND, a & b)
+	ALU_I(I_XOR, a ^ b)
+	ALU_I(I_LSL, a << b)
+	ALU_I(I_LSR, a >> b)
+	ALU_I(I_ASR, (int32_t)(a >> b))
+
+	ALU_R(R_ADD, a + b)
+	ALU_CC(R_ADDS, REG(op->rr), ALU_PLUS, a + b)
+	ALU_R(R_SUB, a - b)
+	ALU_CC(R_SUBS, REG(op->rr), ALU_MINUS, a - b)
+	ALU_R(R_OR, a | b)
+	ALU_R(R_AND, a & b)
+	ALU_R(R_XOR, a ^ b)
+	ALU_R(R_LSL, a << b)
+	ALU_R(R_LSR, a >> b)
+	ALU_R(R_ASR, (int32_t)(a >> b))
+	ALU_R(R_MUL, a * b)
+	ALU_R(R_DIV, a / b)
+
+NOT:
+	SETREG(op->rd, ~REG(op->rs));
+	NEXT();
+
+LOAD: {
+		memerr_t err = MEMERR_NONE;
+		uint32_t val = dmemRead(MEM_ADDR(), op->aux, &err);
+
+		// The destination is written even if the read faulted
+		SETREG(op->rd, val);
+		if (err != MEMERR_NONE) {
+			handleMemErr(err);
+			goto leave;
+		}
+	}
+	NEXT();
+
+STORE: {
+		memerr_t err = dmemWrite(MEM_ADDR(), op->aux, REG(op->rd));
+		if (err != MEMERR_NONE) {
+			handleMemErr(err);
+			goto leave;
+		}
+	}
+	NEXT();
+
+BCOND:
+	if (checkCondFlags((cond_t) op->aux, core.CSTR)) {
+		core.IR = (core.IR-4) + ((op->imm & 0x7ffff) << 2);
+		EXIT(BLOCK_EXIT_TAKEN);
+	}
+	EXIT(BLOCK_EXIT_FALL);
+
+CALL:
+	core.GPR[28] = core.IR;
+UB:
+	core.IR = (core.IR-4) + (((int32_t)(((op->imm & 0xffffff) << 2) << 9)) >> 9);
+	EXIT(BLOCK_EXIT_TAKEN);
+
+UBR:
+	// The slot keeps the last target, which the address check in chain verifies
+	core.IR = REG(op->rs);
+	EXIT(BLOCK_EXIT_TAKEN);
+
+blockEnd:
+	// Cut short by the budget
+	if (end != blk->ops + blk->length) {
+		lastOpcode = op->opcode;
+		goto done;
+	}
+	exitSlot = BLOCK_EXIT_FALL;
+
+chain:
+	lastOpcode = op->opcode;
+	if (retired == budget) goto done;
+
+	if (blk->next[exitSlot] && blk->next[exitSlot]->addr == core.IR) {
+		blk = blk->next[exitSlot];
+		goto enter;
+	}
+
+	linkFrom = blk;
+	goto lookup;
+
+leave:
+	// An exception moved IR, the block cannot be chained from here
+	lastOpcode = op->opcode;
+	core.status = STAT_RUNNING; // The next fetch would clear it
+	linkFrom = NULL;
+
+lookup: {
+		if (retired == budget) goto done;
+
+		// A pending CSTR write is committed in the middle of decode, leave it to the pipeline
+		if (core.setCSTR & CSTR_COMMIT) goto slow;
+
+		uint8_t priv = GET_PRIV(core.CSTR);
+		uint32_t gen = blockGeneration();
+		bblock_t* found = lookupBlock(core.IR, priv);
+
+		if (!found) {
+			found = startBlock(core.IR, priv);
+
+			uint32_t length = 0;
+			uint32_t addr = core.IR;
+			while (length < BLOCK_MAX_OPS) {
+				uint32_t instrbits = 0x00000000;
+				memerr_t err = MEMERR_NONE;
+				imem(addr, &instrbits, &err);
+				if (err != MEMERR_NONE) break;
+
+				pdinstr_t* pd = predecode(addr, instrbits);
+				if (!pd) break;
+
+				const void* handler = NULL;
+				switch (pd->iType) {
+					case I_TYPE: handler = iHandlers[pd->opcode]; break;
+					case R_TYPE: handler = rHandlers[pd->opcode]; break;
+					case M_TYPE: handler = pd->write ? &&STORE : &&LOAD; break;
+					case BC_TYPE: handler = &&BCOND; break;
+					case BI_TYPE: handler = (pd->opcode == OP_CALL) ? &&CALL : &&UB; break;
+					case BU_TYPE: handler = &&UBR; break;
+					default: break; // S-types are left to the pipeline
+				}
+				if (!handler) break;
+
+				bop_t* bop = &found->ops[length++];
+				bop->handler = handler;
+				bop->imm = pd->imm;
+				bop->rd = pd->rd;
+				bop->rs = pd->rs;
+				bop->rr = pd->rr;
+				bop->aux = (pd->iType == BC_TYPE) ? u32bitextract(pd->instrbits, 0, 4) : pd->memSize;
+				bop->opcode = pd->opcode;
+				bop->iType = pd->iType;
+
+				addr += 4;
+				if (pd->iType == BC_TYPE || pd->iType == BI_TYPE || pd->iType == BU_TYPE) break;
+			}
+
+			found = commitBlock(found, length);
+			if (!found) goto slow;
+		}
+
+		// Chains are only made between blocks of the same generation
+		if (linkFrom && gen == blockGeneration()) linkFrom->next[exitSlot] = found;
+		blk = found;
+	}
+
+enter: {
+		uint32_t left = budget - retired;
+
+		// Translated blocks run whole, so only if the budget allows it
+		if (blk->code && blk->length <= left) {
+			uint32_t res = ((jitfn_t) blk->code)(&core);
+			retired += JIT_EXIT_COUNT(res);
+			op = &blk->ops[JIT_EXIT_COUNT(res) - 1];
+
+			if (JIT_EXIT_KIND(res) == JIT_EXIT_LEAVE) goto leave;
+			EXIT(JIT_EXIT_KIND(res));
+		}
+		if (cpuEngine == ENGINE_JIT && ++blk->hits == JIT_HOT_THRESHOLD) jitBlock(blk);
+
+		op = blk->ops;
+		end = op + ((blk->length < left) ? blk->length : left);
+		core.IR += 4;
+		retired++;
+		goto *op->handler;
+	}
+
+slow:
+	FetchCtx.opcode = lastOpcode;
+	stepCore();
+	retired++;
+	lastOpcode = FetchCtx.opcode;
+	linkFrom = NULL;
+
+	if (core.status == STAT_HLT || core.status == STAT_IO) goto done;
+	if (core.status == STAT_EXCP) core.status = STAT_RUNNING;
+	goto lookup;
+
+done:
+	FetchCtx.opcode = lastOpcode;
+
+	dDebug(DB_DETAIL, "Fast engine retired %d instructions, now at 0x%x", retired, core.IR);
+	return retired;
+}
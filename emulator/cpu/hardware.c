@@ -55,33 +55,56 @@ void alu() {
 
 	if (DecodeCtx.setCC) {
 		dLog(D_NONE, DSEV_INFO, "Setting condition");
-		bool C = false;
-		bool O = false;
-		bool N = (res & 0x80000000) == 0;
-		bool Z = res == 0;
+		setCondFlags(DecodeCtx.aluop, vala, valb, res);
+		dLog(D_NONE, DSEV_INFO, "Flags: 0x%x", core.CSTR & 0xF);
+	}
+}
 
+void setCondFlags(aluop_t aluop, uint32_t vala, uint32_t valb, uint32_t res) {
+	bool C = false;
+	bool O = false;
+	bool N = (res & 0x80000000) == 0;
+	bool Z = res == 0;
 
-		C = res < vala || res < valb;
 
-		int32_t signedVala = (int32_t) vala;
-		int32_t signedValb = (int32_t) valb;
-		int32_t signedRes = signedVala + signedValb;
+	C = res < vala || res < valb;
 
-		// Check overflow for substraction
-		if (DecodeCtx.aluop == ALU_MINUS) {
-			signedRes = signedVala - signedValb;
+	int32_t signedVala = (int32_t) vala;
+	int32_t signedValb = (int32_t) valb;
+	int32_t signedRes = signedVala + signedValb;
 
-			if (signedVala > 0 && signedValb < 0 && signedRes > 0) O = true;
-			if (vala >= valb) C = true;
-			else if (signedVala < 0 && signedValb > 0 && signedRes < 0) O = true;
-		} else { // for addition
-			if (signedVala >= 0 && signedValb >= 0 && signedRes <= 0) O = true;
-			else if (signedVala < 0 && signedValb < 0 && signedRes >= 0) O = true;
-		}
+	// Check overflow for substraction
+	if (aluop == ALU_MINUS) {
+		signedRes = signedVala - signedValb;
+
+		if (signedVala > 0 && signedValb < 0 && signedRes > 0) O = true;
+		if (vala >= valb) C = true;
+		else if (signedVala < 0 && signedValb > 0 && signedRes < 0) O = true;
+	} else { // for addition
+		if (signedVala >= 0 && signedValb >= 0 && signedRes <= 0) O = true;
+		else if (signedVala < 0 && signedValb < 0 && signedRes >= 0) O = true;
+	}
 
-		core.CSTR = (core.CSTR & ~0xF) | (SET_CONDS(C,O,N,Z) & 0xF);
-		dLog(D_NONE, DSEV_INFO, "Flags: 0x%x", SET_CONDS(C,O,N,Z));
+	core.CSTR = (core.CSTR & ~0xF) | (SET_CONDS(C,O,N,Z) & 0xF);
+}
+
+bool checkCondFlags(cond_t cond, uint16_t cstr) {
+	switch (cond)	{
+		case COND_EQ: return GET_Z(cstr) == 1;
+		case COND_NE: return GET_Z(cstr) == 0;
+		case COND_OV: return GET_O(cstr) == 1;
+		case COND_NV: return GET_O(cstr) == 0;
+		case COND_MI: return GET_N(cstr) == 1;
+		case COND_PZ: return GET_N(cstr) == 0;
+		case COND_CC: return GET_C(cstr) == 0;
+		case COND_CS: return GET_C(cstr) == 1;
+		case COND_GT: return GET_N(cstr) == GET_O(cstr) && GET_Z(cstr) == 0;
+		case COND_GE: return GET_N(cstr) == GET_O(cstr);
+		case COND_LT: return GET_N(cstr) != GET_O(cstr);
+		case COND_LE: return GET_N(cstr) != GET_O(cstr) || GET_Z(cstr) != 0;
 	}
+
+	return false;
 }
 
 void fpu() {}
@@ -89,13 +112,10 @@ void fpu() {}
 void vcu() {}
 
 void regfile(bool write) {
-	const int COMMIT_PRIV = 0b1<<15;
-	static uint32_t setCSTR;
-
-	if ((setCSTR >> 15) == 0b1) {
+	if ((core.setCSTR >> 15) == 0b1) {
 		// Commit CSTR, ignoring last bit
-		core.CSTR = setCSTR & ~COMMIT_PRIV;
-		setCSTR = 0x00000000; // reset
+		core.CSTR = core.setCSTR & ~CSTR_COMMIT;
+		core.setCSTR = 0x00000000; // reset
 	}
 
 
@@ -121,7 +141,7 @@ void regfile(bool write) {
 			// Basically a boolean "writebackCSTR?"
 			// This writeback is done regardless if there is a normal writeback or not in order to commit to the next instruction
 			// The first step is on MVCSTR cycle, indicating to commit and set it
-			setCSTR = MemoryCtx.valout | COMMIT_PRIV;
+			core.setCSTR = MemoryCtx.valout | CSTR_COMMIT;
 			return;
 		} else if (FetchCtx.opcode == OP_RESR) {
 			MemoryCtx.valout = core.ESR;
@@ -168,30 +188,50 @@ void imem(uint32_t addr, uint32_t* ival, memerr_t* imemErr) {
 	*ival = (uint32_t) memReadInt(addr, imemErr);
 }
 
-void dmem(uint32_t addr, uint32_t* rval, uint32_t* wval, memerr_t* imemErr) {
-	if (DecodeCtx.memSize == 0) return;
+uint32_t dmemRead(uint32_t addr, int size, memerr_t* memErr) {
+	int (*memRead)(uint32_t, memerr_t*);
 
-	// Both cannot be null at the same time
-	if (!rval && !wval) { *imemErr = MEMERR_INTERNAL; return; }
+	switch (size)	{
+		case 1:
+			memRead = &memReadByte;
+			break;
+		case 2:
+			memRead = &memReadShort;
+			break;
+		case 4:
+		default:
+			memRead = &memReadInt;
+			break;
+	}
 
-	int (*memRead)(uint32_t, memerr_t*);
+	return (uint32_t) memRead(addr, memErr);
+}
+
+memerr_t dmemWrite(uint32_t addr, int size, uint32_t val) {
 	memerr_t (*memWrite)(uint32_t, int);
 
-	switch (DecodeCtx.memSize)	{
+	switch (size)	{
 		case 1:
-			memRead = &memReadByte;
 			memWrite = &memWriteByte;
 			break;
 		case 2:
-			memRead = &memReadShort;
 			memWrite = &memWriteShort;
 			break;
 		case 4:
-			memRead = &memReadInt;
+		default:
 			memWrite = &memWriteInt;
 			break;
 	}
 
-	if (wval) *imemErr = memWrite(addr, *wval);
-	else *rval = (uint32_t) memRead(addr, imemErr);
+	return memWrite(addr, val);
+}
+
+void dmem(uint32_t addr, uint32_t* rval, uint32_t* wval, memerr_t* imemErr) {
+	if (DecodeCtx.memSize == 0) return;
+
+	// Both cannot be null at the same time
+	if (!rval && !wval) { *imemErr = MEMERR_INTERNAL; return; }
+
+	if (wval) *imemErr = dmemWrite(addr, DecodeCtx.memSize, *wval);
+	else *rval = dmemRead(addr, DecodeCtx.memSize, imemErr);
 }
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "hardware.h"
+#include "diagnostics.h"
+
+
+extern core_t core;
+
+#if defined(__x86_64__)
+
+static uint8_t* codeCache;
+static uint32_t codeUsed;
+static bool cacheFull;
+// The block generation the code was emitted for, older code is no longer reachable
+static uint32_t codeGen;
+
+static uint8_t* emitPtr;
+
+// Operand encodings for `op reg, [rbx+disp32]`
+#define MODRM_EAX 0x83
+#define MODRM_ECX 0x8B
+#define MODRM_EDX 0x93
+#define MODRM_ESI 0xB3
+
+#define CORE_OFF(field) ((uint32_t) offsetof(core_t, field))
+
+static void emit8(uint8_t byte) { *emitPtr++ = byte; }
+static void emit32(uint32_t val) { memcpy(emitPtr, &val, 4); emitPtr += 4; }
+static void emit64(uint64_t val) { memcpy(emitPtr, &val, 8); emitPtr += 8; }
+
+static uint32_t regOffset(uint8_t r) {
+	// Index 31 is SP
+	if (r == 31) return CORE_OFF(SP);
+	return CORE_OFF(GPR) + r*4;
+}
+
+// mov r32, [rbx+reg]
+static void emitReadReg(uint8_t modrm, uint8_t r) {
+	emit8(0x8B); emit8(modrm); emit32(regOffset(r));
+}
+
+// mov [rbx+reg], eax
+static void emitWriteReg(uint8_t r) {
+	// Writes to X30 are dropped
+	if (r == 30) return;
+	emit8(0x89); emit8(MODRM_EAX); emit32(regOffset(r));
+}
+
+// mov dword [rbx+IR], imm32
+static void emitSetIR(uint32_t ir) {
+	emit8(0xC7); emit8(0x83); emit32(CORE_OFF(IR)); emit32(ir);
+}
+
+// movabs rax, fn; call rax
+static void emitCall(void* fn) {
+	emit8(0x48); emit8(0xB8); emit64((uint64_t) fn);
+	emit8(0xFF); emit8(0xD0);
+}
+
+// mov eax, res; pop rbx; ret
+static void emitReturn(uint32_t res) {
+	emit8(0xB8); emit32(res);
+	emit8(0x5B);
+	emit8(0xC3);
+}
+
+// test eax, eax; jz over; leave with the ops so far
+static void emitLeaveIfSet(uint32_t count) {
+	emit8(0x85); emit8(0xC0);
+	emit8(0x74); emit8(7);
+	emitReturn((count << 2) | JIT_EXIT_LEAVE);
+}
+
+
+// Memory ops go through the same checks as the interpreter
+static uint32_t jitLoad(uint32_t addr, int size, uint32_t rd) {
+	memerr_t err = MEMERR_NONE;
+	uint32_t val = dmemRead(addr, size, &err);
+
+	// The destination is written even if the read faulted
+	if (rd == 31) core.SP = val;
+	else if (rd != 30) core.GPR[rd] = val;
+
+	if (err == MEMERR_NONE) return 0;
+
+	handleMemErr(err);
+	return 1;
+}
+
+static uint32_t jitStore(uint32_t addr, int size, uint32_t val) {
+	memerr_t err = dmemWrite(addr, size, val);
+	if (err == MEMERR_NONE) return 0;
+
+	handleMemErr(err);
+	return 1;
+}
+
+
+static bool emitALU(bop_t* op) {
+	emitReadReg(MODRM_EAX, op->rs);
+	if (op->iType == I_TYPE) { emit8(0xB9); emit32((uint32_t) op->imm); } // mov ecx, imm32
+	else emitReadReg(MODRM_ECX, op->rr);
+
+	switch (op->opcode) {
+		case OP_ADD: emit8(0x01); emit8(0xC8); break; // add eax, ecx
+		case OP_SUB: emit8(0x29); emit8(0xC8); break; // sub eax, ecx
+		case OP_OR: emit8(0x09); emit8(0xC8); break; // or eax, ecx
+		case OP_AND: emit8(0x21); emit8(0xC8); break; // and eax, ecx
+		case OP_XOR: emit8(0x31); emit8(0xC8); break; // xor eax, ecx
+		case OP_NOT: emit8(0xF7); emit8(0xD0); break; // not eax
+		case OP_LSL: emit8(0xD3); emit8(0xE0); break; // shl eax, cl
+		case OP_LSR: case OP_ASR: emit8(0xD3); emit8(0xE8); break; // shr eax, cl (ASR is logical, as in alu())
+		case OP_MUL: case OP_SMUL: emit8(0x0F); emit8(0xAF); emit8(0xC1); break; // imul eax, ecx
+		case OP_DIV: case OP_SDIV: // xor edx, edx; div ecx
+			emit8(0x31); emit8(0xD2);
+			emit8(0xF7); emit8(0xF1);
+			break;
+		case OP_ADDS: case OP_SUBS: {
+			aluop_t aluop = (op->opcode == OP_ADDS) ? ALU_PLUS : ALU_MINUS;
+			emit8(0x89); emit8(0xC6); // mov esi, eax
+			emit8(0x89); emit8(0xCA); // mov edx, ecx
+			if (aluop == ALU_PLUS) { emit8(0x01); emit8(0xC8); }
+			else { emit8(0x29); emit8(0xC8); }
+			emitWriteReg(op->rd);
+			emit8(0x89); emit8(0xC1); // mov ecx, eax
+			emit8(0xBF); emit32(aluop); // mov edi, aluop
+			emitCall((void*) &setCondFlags);
+			return true;
+		}
+		default:
+			return false;
+	}
+
+	emitWriteReg(op->rd);
+	return true;
+}
+
+static void emitMem(bop_t* op, uint32_t addr, uint32_t count) {
+	// Exceptions save IR
+	emitSetIR(addr + 4);
+
+	// M-types use the index register when there is no offset
+	emitReadReg(MODRM_EAX, op->rs);
+	if (op->imm == 0) { emit8(0x03); emit8(MODRM_EAX); emit32(regOffset(op->rr)); } // add eax, [rbx+rr]
+	else { emit8(0x05); emit32((uint32_t) op->imm); } // add eax, imm32
+
+	emit8(0x89); emit8(0xC7); // mov edi, eax
+	emit8(0xBE); emit32(op->aux); // mov esi, size
+	if (op->opcode >= OP_STR && op->opcode <= OP_STRH) {
+		emitReadReg(MODRM_EDX, op->rd);
+		emitCall((void*) &jitStore);
+	} else {
+		emit8(0xBA); emit32(op->rd); // mov edx, rd
+		emitCall((void*) &jitLoad);
+	}
+
+	emitLeaveIfSet(count);
+}
+
+static void emitBranch(bop_t* op, uint32_t addr, uint32_t count) {
+	// IR-4 is the address of the branch
+	switch (op->opcode) {
+		case OP_B: {
+			uint32_t target = addr + ((op->imm & 0x7ffff) << 2);
+			emit8(0xBF); emit32(op->aux); // mov edi, cond
+			emit8(0x0F); emit8(0xB7); emit8(MODRM_ESI); emit32(CORE_OFF(CSTR)); // movzx esi, word [rbx+CSTR]
+			emitCall((void*) &checkCondFlags);
+			emit8(0x84); emit8(0xC0); // test al, al
+			emit8(0x74); emit8(17); // jz fallthrough
+			emitSetIR(target);
+			emitReturn((count << 2) | BLOCK_EXIT_TAKEN);
+			emitSetIR(addr + 4);
+			emitReturn((count << 2) | BLOCK_EXIT_FALL);
+			break;
+		}
+		case OP_CALL:
+			emit8(0xB8); emit32(addr + 4); // mov eax, addr+4
+			emitWriteReg(28);
+			// fallthrough
+		case OP_UB:
+			emitSetIR(addr + (((int32_t)(((op->imm & 0xffffff) << 2) << 9)) >> 9));
+			emitReturn((count << 2) | BLOCK_EXIT_TAKEN);
+			break;
+		default: // UBR/RET
+			emitReadReg(MODRM_EAX, op->rs);
+			emit8(0x89); emit8(MODRM_EAX); emit32(CORE_OFF(IR)); // mov [rbx+IR], eax
+			emitReturn((count << 2) | BLOCK_EXIT_TAKEN);
+			break;
+	}
+}
+
+bool initJIT() {
+	void* cache = mmap(NULL, JIT_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (cache == MAP_FAILED) {
+		dLog(D_NONE, DSEV_WARN, "Could not map the JIT code cache, staying with the interpreter");
+		return false;
+	}
+
+	codeCache = (uint8_t*) cache;
+	codeUsed = 0;
+	cacheFull = false;
+	codeGen = blockGeneration();
+
+	dLog(D_NONE, DSEV_INFO, "JIT code cache at %p (%d bytes)", cache, JIT_CACHE_SIZE);
+	return true;
+}
+
+bool jitBlock(bblock_t* block) {
+	if (!codeCache) return false;
+
+	if (codeGen != blockGeneration()) {
+		codeGen = blockGeneration();
+		codeUsed = 0;
+		cacheFull = false;
+	}
+
+	if (cacheFull) return false;
+	if (codeUsed + JIT_MAX_BLOCK_CODE > JIT_CACHE_SIZE) {
+		dLog(D_NONE, DSEV_INFO, "JIT code cache full, no more blocks are translated until the next flush");
+		cacheFull = true;
+		return false;
+	}
+
+	uint8_t* start = codeCache + codeUsed;
+	emitPtr = start;
+
+	// The core context stays pinned in rbx
+	emit8(0x53); // push rbx
+	emit8(0x48); emit8(0x89); emit8(0xFB); // mov rbx, rdi
+
+	uint32_t addr = block->addr;
+	for (uint32_t i = 0; i < block->length; i++, addr += 4) {
+		bop_t* op = &block->ops[i];
+		uint32_t count = i+1;
+
+		switch (op->iType) {
+			case I_TYPE: case R_TYPE:
+				if (!emitALU(op)) return false;
+				break;
+			case M_TYPE:
+				emitMem(op, addr, count);
+				break;
+			case BC_TYPE: case BI_TYPE: case BU_TYPE:
+				// Always the last op
+				emitBranch(op, addr, count);
+				break;
+			default:
+				return false;
+		}
+	}
+
+	// Blocks not ending with a branch fall through to the next instruction
+	bop_t* last = &block->ops[block->length-1];
+	if (last->iType != BC_TYPE && last->iType != BI_TYPE && last->iType != BU_TYPE) {
+		emitSetIR(addr);
+		emitReturn((block->length << 2) | BLOCK_EXIT_FALL);
+	}
+
+	codeUsed += emitPtr - start;
+	block->code = (void*) start;
+	dDebug(DB_DETAIL, "Translated block at 0x%x (%d ops) to %ld bytes", block->addr, block->length, (long)(emitPtr - start));
+
+	return true;
+}
+
+#else
+
+bool initJIT() {
+	dLog(D_NONE, DSEV_WARN, "The JIT only supports x86-64 hosts, staying with the interpreter");
+	return false;
+}
+
+bool jitBlock(bblock_t* block) {
+	return false;
+}
+
+#endif
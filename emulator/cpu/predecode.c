@@ -0,0 +1,39 @@
+#include <string.h>
+
+#include "predecode.h"
+#include "emSignal.h"
+#include "diagnostics.h"
+
+
+extern SigMem* sigMem;
+
+// Direct-mapped, indexed by the word address of the instruction
+static pdinstr_t pdcache[PREDECODE_SIZE];
+// The text generation the entries were decoded under
+static uint32_t pdTextGen;
+
+
+void flushPredecode() {
+	memset(pdcache, 0x0, sizeof(pdcache));
+	pdTextGen = sigMem->metadata.textGen;
+	dDebug(DB_DETAIL, "Flushed predecoded instructions (text generation %d)", pdTextGen);
+}
+
+pdinstr_t* lookupPredecoded(uint32_t addr) {
+	// The emulator bumps the generation whenever the loader writes text (USER_TEXT, SYS_LIB, kernel)
+	// Text cannot be written by guest code so this is the only way entries go stale
+	if (sigMem->metadata.textGen != pdTextGen) flushPredecode();
+
+	pdinstr_t* entry = &pdcache[PREDECODE_IDX(addr)];
+	if (entry->valid && entry->addr == addr) return entry;
+
+	return NULL;
+}
+
+pdinstr_t* claimPredecoded(uint32_t addr) {
+	pdinstr_t* entry = &pdcache[PREDECODE_IDX(addr)];
+	entry->valid = false;
+	entry->addr = addr;
+
+	return entry;
+}
\ No newline at end of file
@@ -291,14 +291,14 @@ static pid_t openShell(char* shellExe, bool log) {
 	return pid;
 }
 
-static pid_t runCPU(char* cpuExe, bool log) {
+static pid_t runCPU(char* cpuExe, bool log, char* engine) {
 	pid_t pid = fork();
 	if (pid == -1) {
 		return -1;
 	} else if (pid == 0) {
 		setpgid(0, 0);
 		redirectOut("cpu.log");
-		char* args[] = {cpuExe, NULL};
+		char* args[] = {cpuExe, engine, NULL};
 		execv(cpuExe, args);
 		perror("fail to exec cpu");
 		exit(1);
@@ -328,13 +328,15 @@ static int loadLib(struct argparse* self, const struct argparse_option* option)
 	return 0;
 }
 
-static char* parseArgs(int argc, char const* argv[], char** cpuimg, char** shell, bool* log) {
+static char* parseArgs(int argc, char const* argv[], char** cpuimg, char** shell, bool* log, bool* reference, bool* jit) {
 	bool showVersion = false;
 
 	struct argparse_option options[] = {
 		OPT_STRING('c', "cpu", cpuimg, "Path to CPU binary image", NULL, 0, 0),
 		OPT_STRING('s', "shell", shell, "Path to shell binary", NULL, 0, 0),
 		OPT_BOOLEAN('l', "log", log, "Enable logging", NULL, 0, 0),
+		OPT_BOOLEAN('r', "reference", reference, "Run the CPU with the staged reference pipeline instead of the fast interpreter", NULL, 0, 0),
+		OPT_BOOLEAN('j', "jit", jit, "Translate hot code to native code (x86-64 hosts only)", NULL, 0, 0),
 		OPT_STRING('-', "libload", NULL, "Load shared library at startup", &loadLib, 0, 0),
 		OPT_BOOLEAN('v', "version", &showVersion, "Show version information", NULL, 0, 0),
 		OPT_HELP(),
@@ -371,8 +373,14 @@ int main(int argc, char const* argv[]) {
 	char* cpuimg = "iaru0";
 	char* shell = "ash";
 	bool log = false;
+	bool reference = false;
+	bool jit = false;
 
-	kernimgFilename = parseArgs(argc, argv, &cpuimg, &shell, &log);
+	kernimgFilename = parseArgs(argc, argv, &cpuimg, &shell, &log, &reference, &jit);
+
+	char* engine = NULL;
+	if (reference) engine = "--reference";
+	else if (jit) engine = "--jit";
 
 	int shellExists = access(shell, F_OK);
 	if (shellExists == -1) dFatal(D_ERR_IO, "Shell binary `%s` does not exist.", shell);
@@ -397,7 +405,7 @@ int main(int argc, char const* argv[]) {
 	redefineSignal(SIGSEGV, &handleSIGSEGV);
 
 	// Spawn CPU
-	pid_t CPUPID = runCPU(cpuimg, log);
+	pid_t CPUPID = runCPU(cpuimg, log, engine);
 	// Spawn shell
 	pid_t shellPID = openShell(shell, log);
 	// Shell now takes control of the main stdout/err
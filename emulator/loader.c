@@ -14,6 +14,16 @@
 
 
 DyLibCache dylibCache;
+extern SigMem* signalsMemory;
+
+/**
+ * Lets the CPU know that text in the emulated memory has been (re)written.
+ * Any instruction it has predecoded is stale after this.
+ */
+static void invalidateText() {
+	// Libraries passed via `--libload` are loaded before signal memory exists
+	if (signalsMemory) signalsMemory->metadata.textGen++;
+}
 
 static void addLibToCache(DyLibCache* cache, char* libname, uint32_t vaddr, uint8_t* paddr, DyLibSymb* symbs, uint32_t symbCount) {
 	// For now, the cache will be linear
@@ -84,6 +94,7 @@ uint32_t loadKernel(char* filename, uint8_t* memory) {
 			dDebug(DB_DETAIL, "First item in text: 0x%x from 0x%x", *(textStart), *(kernimgText));
 
 			memcpy(textStart, kernimgText, sectHdr->shSectSize);
+			invalidateText();
 		} else if (strncmp(".evt", sectHdr->shSectName, 8) == 0) {
 			uint8_t* evtStart = memory + EVT_START;
 			uint8_t* kernimgEvt = kernimg + sectHdr->shSectOff;
@@ -92,6 +103,7 @@ uint32_t loadKernel(char* filename, uint8_t* memory) {
 			dDebug(DB_DETAIL, "First item in EVT: 0x%x from 0x%x", *(evtStart), *(kernimgEvt));
 
 			memcpy(evtStart, kernimgEvt, sectHdr->shSectSize);
+			invalidateText();
 		}
 	}
 
@@ -172,6 +184,7 @@ uint32_t loadBinary(char* filename, uint8_t* memory) {
 			dDebug(DB_DETAIL, "First item in text: 0x%x from 0x%x", *(textStart), *(binaryText));
 
 			memcpy(textStart, binaryText, sectHdr->shSectSize);
+			invalidateText();
 		}
 	}
 
@@ -258,6 +271,8 @@ int loadLibrary(char* filename, uint8_t* memory) {
 		sprintf(fullPath, "%s/%s.adlib", libpath, filename);
 
 		if (loadLibBinary(fullPath, filename)) {
+			// Library code lives in SYS_LIB
+			invalidateText();
 			free(fullPath);
 			return 0;
 		}
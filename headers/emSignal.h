@@ -84,6 +84,7 @@ typedef struct SignalMetadata {
 	pid_t shellPID;
 	pid_t cpuPID;
 	uint8_t signalType; // The type of signal to check (*_SIG)
+	uint32_t textGen; // Bumped by the loader each time text is written, for the CPU to drop predecoded instructions
 	void* heap[3]; // 0 for emulator heap, 1 for shell heap, 2 for cpu heap
 } signal_md;
 
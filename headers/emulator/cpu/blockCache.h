@@ -0,0 +1,88 @@
+#ifndef _BLOCKCACHE_H_
+#define _BLOCKCACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "instr.h"
+
+
+#define BLOCK_MAX_OPS 64
+#define BLOCK_POOL_SIZE 8192
+#define BLOCK_OPS_POOL_SIZE (BLOCK_POOL_SIZE*16)
+#define BLOCK_MAP_BITS 12
+#define BLOCK_MAP_SIZE (1<<BLOCK_MAP_BITS)
+#define BLOCK_MAP_IDX(addr, priv) ((((addr)>>2) ^ ((priv)<<(BLOCK_MAP_BITS-1))) & (BLOCK_MAP_SIZE-1))
+
+// Successor slots of a block
+#define BLOCK_EXIT_TAKEN 0 // Branch target, also used for the last target of UBR/RET
+#define BLOCK_EXIT_FALL 1 // Next instruction after the block
+
+/**
+ * A predecoded instruction inside a block, only keeping what the fast engine handlers read.
+ */
+typedef struct BlockOp {
+	const void* handler;
+	int32_t imm;
+	uint8_t rd, rs, rr;
+	uint8_t aux; // Memory width for M-types, condition for B
+	opcode_t opcode;
+	itype_t iType;
+} bop_t;
+
+/**
+ * A run of instructions ending at a branch, an S-type, or an instruction the fast engine does not handle.
+ * Blocks are built for the privilege level their fetches were validated under.
+ */
+typedef struct BasicBlock {
+	uint32_t addr;
+	uint8_t priv;
+	uint32_t length;
+	bop_t* ops;
+	struct BasicBlock* next[2]; // Chained successors, only valid if its addr matches the next IR
+
+	uint32_t hits; // Times the block was entered while interpreted
+	void* code; // Native code from the JIT, NULL if interpreted
+} bblock_t;
+
+
+/**
+ * Drops every block and chain.
+ */
+void flushBlocks();
+
+/**
+ * Finds the block starting at the given address.
+ * If the loader has written new text since the last lookup, every block is dropped first.
+ * @param addr The address of the first instruction
+ * @param priv The privilege level the block runs under
+ * @return The block, NULL if there is none
+ */
+bblock_t* lookupBlock(uint32_t addr, uint8_t priv);
+
+/**
+ * Starts a new block with room for BLOCK_MAX_OPS ops.
+ * If the pools are exhausted, every block is dropped first.
+ * The block is not visible to lookupBlock() until it is committed.
+ * @param addr The address of the first instruction
+ * @param priv The privilege level the block runs under
+ * @return The block
+ */
+bblock_t* startBlock(uint32_t addr, uint8_t priv);
+
+/**
+ * Finishes the block from startBlock(), giving back the ops it did not use.
+ * @param block The block
+ * @param length The number of ops filled in, 0 to discard the block
+ * @return The block, NULL if it was discarded
+ */
+bblock_t* commitBlock(bblock_t* block, uint32_t length);
+
+/**
+ * Gets the number of times the blocks were dropped.
+ * Pointers to blocks from before a change must not be used.
+ * @return The generation
+ */
+uint32_t blockGeneration();
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "instr.h"
+#include "mem.h"
 
 
 typedef enum status {
@@ -13,6 +14,12 @@ typedef enum status {
 	STAT_IO
 } status_t;
 
+typedef enum Engine {
+	ENGINE_FAST, // Threaded interpreter over predecoded instructions
+	ENGINE_JIT, // Threaded interpreter, translating hot blocks to native code
+	ENGINE_REFERENCE // Staged fetch/decode/execute/memory pipeline
+} engine_t;
+
 typedef struct __attribute__((packed)) VectorRegister {
 	union {
 		uint64_t _v64[8];
@@ -64,6 +71,7 @@ typedef struct Core {
 	vec_reg_t VR[6];
 	uint16_t CSTR;
 	uint16_t ESR;
+	uint32_t setCSTR; // CSTR written by MVCSTR, committed on the next register read if CSTR_COMMIT is set
 
 	InstrCtx uarch;
 	status_t status;
@@ -96,6 +104,8 @@ typedef struct Core {
 #define GET_PRIV(flags) ((flags>>9) & 0b1)
 #define GET_AVE(flags) ((flags>>14) & 0b1)
 
+#define CSTR_COMMIT (0b1<<15)
+
 #define INTERRUPTS_ENABLE 0b1
 #define PRIVILEGE_KERNEL 0b1
 #define AVEXT_ENABLE 0b1
@@ -104,4 +114,32 @@ typedef struct Core {
 void initCore();
 void* runCore(void*);
 
+/**
+ * Runs a single instruction through the staged pipeline.
+ */
+void stepCore();
+
+/**
+ * Signals the emulator and shell that the core has faulted in kernel mode.
+ */
+void fault();
+
+/**
+ * Saves the user state, switches to kernel mode, and jumps to the EVT.
+ * @param excpNum The exception number placed in ESR
+ */
+void exception(uint16_t excpNum);
+
+/**
+ * Raises the exception or fault for a failed instruction fetch.
+ * @param err The error from imem
+ */
+void handleFetchErr(memerr_t err);
+
+/**
+ * Raises the exception or fault for a failed data memory access.
+ * @param err The error from dmem
+ */
+void handleMemErr(memerr_t err);
+
 #endif
\ No newline at end of file
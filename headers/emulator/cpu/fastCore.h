@@ -0,0 +1,19 @@
+#ifndef _FASTCORE_H_
+#define _FASTCORE_H_
+
+#include <stdint.h>
+
+
+/**
+ * Runs the core with the threaded interpreter over basic blocks.
+ * Each op of a block jumps straight to the handler for its opcode, and the last op jumps into the next block
+ * through its chained successor, so loops do not go back to the block lookup.
+ * Anything the handlers do not cover (S-types, pending CSTR writes, fetch errors) goes through stepCore(),
+ * so the architectural state always matches the reference pipeline.
+ * Stops early if the core halts or goes idle for IO.
+ * @param budget The maximum number of instructions to retire
+ * @return The number of instructions retired
+ */
+uint32_t runFast(uint32_t budget);
+
+#endif
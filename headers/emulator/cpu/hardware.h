@@ -5,13 +5,49 @@
 #include <stdbool.h>
 
 #include "mem.h"
+#include "instr.h"
 
 void alu();
 void fpu();
 void vcu();
 void regfile(bool write);
 
+/**
+ * Sets the condition flags of CSTR from an ALU operation.
+ * @param aluop The operation, only ALU_MINUS is treated differently from an addition
+ * @param vala The first ALU input
+ * @param valb The second ALU input
+ * @param res The ALU output
+ */
+void setCondFlags(aluop_t aluop, uint32_t vala, uint32_t valb, uint32_t res);
+
+/**
+ * Checks a branch condition against the flags of a CSTR value.
+ * @param cond The condition
+ * @param cstr The CSTR value
+ * @return Whether the condition holds
+ */
+bool checkCondFlags(cond_t cond, uint16_t cstr);
+
 void imem(uint32_t addr, uint32_t* ival, memerr_t* imemErr);
 void dmem(uint32_t addr, uint32_t* rval, uint32_t* wval, memerr_t* imemErr);
 
+/**
+ * Reads data memory with the given width, checking it against the current privilege.
+ * @param addr The address to read from
+ * @param size The width in bytes (1, 2 or 4)
+ * @param memErr Set if the read is not permitted
+ * @return The value read
+ */
+uint32_t dmemRead(uint32_t addr, int size, memerr_t* memErr);
+
+/**
+ * Writes data memory with the given width, checking it against the current privilege.
+ * @param addr The address to write to
+ * @param size The width in bytes (1, 2 or 4)
+ * @param val The value to write
+ * @return The memory error, MEMERR_NONE if permitted
+ */
+memerr_t dmemWrite(uint32_t addr, int size, uint32_t val);
+
 #endif
\ No newline at end of file
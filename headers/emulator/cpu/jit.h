@@ -0,0 +1,37 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "core.h"
+#include "blockCache.h"
+
+
+#define JIT_HOT_THRESHOLD 64 // Times a block is entered before it is translated
+#define JIT_CACHE_SIZE (4*1024*1024)
+#define JIT_MAX_BLOCK_CODE (BLOCK_MAX_OPS*96 + 64)
+
+// Translated blocks return how many ops they retired and how they left
+#define JIT_EXIT_LEAVE 2 // An op raised an exception, IR was moved
+#define JIT_EXIT_KIND(res) ((res) & 0b11)
+#define JIT_EXIT_COUNT(res) ((res) >> 2)
+
+typedef uint32_t (*jitfn_t)(core_t*);
+
+
+/**
+ * Sets up the executable code cache.
+ * @return Whether the JIT can be used on this host
+ */
+bool initJIT();
+
+/**
+ * Translates a block to native code, setting its code if it succeeds.
+ * Nothing is translated once the code cache is full, until the blocks are next dropped.
+ * @param block The block to translate
+ * @return Whether the block was translated
+ */
+bool jitBlock(bblock_t* block);
+
+#endif
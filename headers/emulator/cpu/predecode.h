@@ -0,0 +1,67 @@
+#ifndef _PREDECODE_H_
+#define _PREDECODE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "instr.h"
+
+
+#define PREDECODE_BITS 12
+#define PREDECODE_SIZE (1<<PREDECODE_BITS)
+#define PREDECODE_IDX(addr) (((addr)>>2) & (PREDECODE_SIZE-1))
+
+/**
+ * The result of decoding the instruction at a text address.
+ * Only the parts of decode() that depend solely on the instruction bits are kept.
+ * Anything depending on the core state (privilege, condition flags, register values) is still done every cycle.
+ */
+typedef struct PredecodedInstruction {
+	uint32_t addr; // The text address the instruction was fetched from
+	bool valid;
+
+	uint32_t instrbits;
+	opcode_t opcode; // For S-types, this is the subopcode
+	itype_t iType;
+	int32_t imm;
+	uint32_t rd, rs, rr;
+	aluop_t aluop;
+	int memSize;
+	bool setCC;
+	bool regwrite;
+	bool memwrite;
+	bool write; // Whether it is a store (MemoryCtx.write)
+} pdinstr_t;
+
+
+/**
+ * Invalidates every predecoded instruction.
+ */
+void flushPredecode();
+
+/**
+ * Gets the predecoded instruction for the given text address.
+ * If the loader has written new text since the last lookup, the cache is flushed first.
+ * @param addr The address of the instruction
+ * @return The entry, NULL if the address has not been decoded yet
+ */
+pdinstr_t* lookupPredecoded(uint32_t addr);
+
+/**
+ * Gets the slot that the given text address maps to, claiming it for that address.
+ * The slot is not valid until the caller fills it in and sets `valid`.
+ * @param addr The address of the instruction
+ * @return The slot
+ */
+pdinstr_t* claimPredecoded(uint32_t addr);
+
+/**
+ * Gets the predecoded instruction for the given text address, decoding the given bits if there is none.
+ * The pipeline contexts are left untouched. Defined by the core.
+ * @param addr The address of the instruction
+ * @param instrbits The instruction fetched from the address
+ * @return The entry, NULL if the instruction is invalid
+ */
+pdinstr_t* predecode(uint32_t addr, uint32_t instrbits);
+
+#endif
\ No newline at end of file
@@ -13,6 +13,7 @@ void setupSignals(SigMem* signalMemory) {
 	signalMemory->metadata.shellPID = -1;
 	signalMemory->metadata.cpuPID = -1;
 	signalMemory->metadata.signalType = 0;
+	signalMemory->metadata.textGen = 0;
 
 	signal_t* sigs = signalMemory->signals;
 